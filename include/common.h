@@ -9,6 +9,12 @@
 const uint16_t SERVER_PORT = 8080;
 const int BUFFER_SIZE = 4096;
 
+// Memory Limits
+const uint32_t MAX_FRAME_SIZE = 64 * 1024 * 1024;        // Largest payload the reader accepts
+const size_t MAX_CONNECTION_MEMORY = 1024 * 1024;        // Buffered payload bytes per connection
+const size_t MAX_GLOBAL_MEMORY = 256 * 1024 * 1024;      // Buffered payload bytes across all connections
+const uint32_t MAX_MANIFEST_CHUNK = 256 * 1024;          // Largest sync manifest FILE_CHUNK
+
 enum class PacketType : uint8_t {
     AUTH = 0x01,
     LIST_REQ = 0x02,
@@ -18,7 +24,12 @@ enum class PacketType : uint8_t {
     SUCCESS = 0x06,
     ERROR = 0x07,
     FILE_CHUNK = 0x08,
-    END_OF_TRANSFER = 0x09
+    END_OF_TRANSFER = 0x09,
+    COPY_REQ = 0x0A,  // Payload: "source\ndestination"
+    MOVE_REQ = 0x0B,  // Payload: "source\ndestination"
+    SYNC_REQ = 0x0C,  // Payload: "mirror" or empty; manifest follows as FILE_CHUNKs
+    SYNC_RESP = 0x0D, // Payload: "U\tname\n" (upload) / "R\tname\n" (stored on server) lines
+    DELETE_REQ = 0x0E // Payload: filename
 };
 
 // Protocol Header
@@ -0,0 +1,40 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Caches file checksums keyed by path (or a caller-chosen key), reusing
+// an entry while the file's size and mtime are unchanged. Safe to share
+// between threads.
+class HashCache {
+public:
+    // Returns the SHA-256 of path, hashing only if the cached entry is stale
+    std::string getHash(const std::string& path) { return getHash(path, path); }
+    std::string getHash(const std::string& key, const std::string& path);
+    void invalidate(const std::string& key);
+    // Drops every entry whose key is not in keys
+    void retainOnly(const std::unordered_set<std::string>& keys);
+
+    // Persistence across runs; save() writes atomically and clears isDirty()
+    bool load(const std::string& cacheFile);
+    bool save(const std::string& cacheFile) const;
+    bool isDirty() const { return dirty.load(); }
+
+private:
+    struct Entry {
+        uintmax_t size;
+        int64_t mtime;
+        std::string hash;
+    };
+
+    mutable std::mutex mutex;
+    mutable std::atomic<bool> dirty{false};
+    std::unordered_map<std::string, Entry> entries;
+};
+
+#endif // HASH_CACHE_H
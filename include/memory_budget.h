@@ -0,0 +1,46 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <atomic>
+#include <cstddef>
+
+// Tracks bytes held in receive buffers. A budget may have a parent
+// (e.g. per-connection -> global) so a reservation must fit in both.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limit, MemoryBudget* parent = nullptr);
+
+    bool tryReserve(size_t bytes);
+    void release(size_t bytes);
+
+    size_t used() const { return usedBytes.load(); }
+    size_t peak() const { return peakBytes.load(); }
+    size_t limit() const { return limitBytes; }
+
+private:
+    size_t limitBytes;
+    MemoryBudget* parent;
+    std::atomic<size_t> usedBytes{0};
+    std::atomic<size_t> peakBytes{0};
+};
+
+// RAII handle for bytes reserved against a MemoryBudget.
+class MemoryReservation {
+public:
+    MemoryReservation() = default;
+    MemoryReservation(MemoryBudget* budget, size_t bytes) : budget(budget), bytes(bytes) {}
+    ~MemoryReservation() { reset(); }
+
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+    MemoryReservation(MemoryReservation&& other) noexcept;
+    MemoryReservation& operator=(MemoryReservation&& other) noexcept;
+
+    void reset();
+
+private:
+    MemoryBudget* budget = nullptr;
+    size_t bytes = 0;
+};
+
+#endif // MEMORY_BUDGET_H
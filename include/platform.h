@@ -12,6 +12,7 @@
 #else
     #include <arpa/inet.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <unistd.h>
     #include <sys/socket.h>
     #include <sys/types.h>
@@ -35,6 +36,12 @@ inline void initSockets() {
 #endif
 }
 
+// Packets are small request/response frames; don't let Nagle hold them back
+inline void setNoDelay(SocketType s) {
+    int opt = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&opt, sizeof(opt));
+}
+
 inline void cleanupSockets() {
 #ifdef _WIN32
     WSACleanup();
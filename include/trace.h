@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <openssl/ssl.h>
+
+// Opt-in per-transfer tracing. Set SFTP_TRACE=<file> to append one JSON
+// line per completed transfer. When unset, every hook reduces to a
+// check of a flag or a null thread-local pointer.
+namespace Trace {
+    enum class Phase { Disk, Tls, Socket };
+
+    void initFromEnv();
+    bool enabled();
+    uint64_t nowNs(); // Monotonic clock
+
+    // Records socket time spent inside this connection's BIO
+    void instrument(SSL* ssl);
+    // Remembers peer and handshake timing for transfers on this thread's connection
+    void setConnection(const std::string& peer, uint64_t handshakeStartNs, uint64_t handshakeEndNs);
+
+    class Transfer {
+    public:
+        // requestNs: when the request arrived (Trace::nowNs()); 0 means now
+        Transfer(const char* op, const std::string& file, uint64_t requestNs = 0);
+        ~Transfer();
+        Transfer(const Transfer&) = delete;
+        Transfer& operator=(const Transfer&) = delete;
+
+        void firstByte();
+        void addBytes(uint64_t n) { bytes += n; }
+        void add(Phase phase, uint64_t ns);
+        void finish(bool ok); // Emits the record; later calls are ignored
+
+        static Transfer* current();
+
+    private:
+        bool active = false;
+        const char* op;
+        std::string file;
+        Transfer* previous = nullptr;
+        uint64_t startNs = 0;
+        uint64_t firstByteNs = 0;
+        uint64_t bytes = 0;
+        uint64_t diskNs = 0;
+        uint64_t tlsNs = 0;
+        uint64_t socketNs = 0;
+    };
+
+    // Charges the enclosed time to the current transfer, if any
+    class Scope {
+    public:
+        explicit Scope(Phase phase) : transfer(Transfer::current()), phase(phase), start(transfer ? nowNs() : 0) {}
+        ~Scope() { if (transfer) transfer->add(phase, nowNs() - start); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Transfer* transfer;
+        Phase phase;
+        uint64_t start;
+    };
+}
+
+#endif // TRACE_H
@@ -3,8 +3,10 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include <openssl/ssl.h>
 #include "common.h"
+#include "memory_budget.h"
 
 namespace Utils {
     void sendPacket(SSL* ssl, PacketType type, const std::vector<uint8_t>& payload);
@@ -12,8 +14,15 @@ namespace Utils {
     struct Packet {
         PacketType type;
         std::vector<uint8_t> payload;
+        MemoryReservation reservation; // Released when the packet is destroyed
     };
-    Packet recvPacket(SSL* ssl);
+    // Reads a header (host byte order); rejects lengths above MAX_FRAME_SIZE.
+    PacketHeader recvHeader(SSL* ssl);
+    // Reads a whole payload into memory, charging it to budget when given.
+    Packet recvPayload(SSL* ssl, const PacketHeader& header, MemoryBudget* budget = nullptr);
+    // Reads a payload in pieces of at most BUFFER_SIZE bytes without buffering it whole.
+    void streamPayload(SSL* ssl, uint32_t length, const std::function<void(const uint8_t*, size_t)>& sink);
+    Packet recvPacket(SSL* ssl, MemoryBudget* budget = nullptr);
     std::string getFileChecksum(const std::string& filepath);
 }
 
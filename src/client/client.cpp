@@ -9,6 +9,13 @@
 #include <filesystem>
 #include <iomanip>
 #include <cmath>
+#include <chrono>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include "hash_cache.h"
+#include "trace.h"
 
 namespace fs = std::filesystem;
 
@@ -55,14 +62,18 @@ void SFTPClient::connectToServer() {
     if (connect(socketFd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
         throw std::runtime_error("Connection failed");
     }
+    setNoDelay(socketFd);
 
     ssl = SSL_new(ctx);
     SSL_set_fd(ssl, socketFd);
+    Trace::instrument(ssl);
 
+    uint64_t handshakeStart = Trace::enabled() ? Trace::nowNs() : 0;
     if (SSL_connect(ssl) <= 0) {
         ERR_print_errors_fp(stderr);
         throw std::runtime_error("SSL Handshake failed");
     }
+    if (Trace::enabled()) Trace::setConnection(host, handshakeStart, Trace::nowNs());
 
     std::cout << GREEN << "Connected securely using " << SSL_get_cipher(ssl) << RESET << std::endl;
     authenticate();
@@ -85,7 +96,10 @@ void SFTPClient::run() {
             if (choice == "1") listFiles();
             else if (choice == "2") uploadFile();
             else if (choice == "3") downloadFile();
-            else if (choice == "4") break;
+            else if (choice == "4") copyRemoteFile();
+            else if (choice == "5") moveRemoteFile();
+            else if (choice == "6") syncDirectory();
+            else if (choice == "7") break;
             else std::cout << RED << "Invalid option." << RESET << std::endl;
         } catch (const std::exception& e) {
             std::cerr << RED << "Error: " << e.what() << RESET << std::endl;
@@ -99,7 +113,10 @@ void SFTPClient::printMenu() {
     std::cout << "1. " << YELLOW << "List Remote Files" << RESET << std::endl;
     std::cout << "2. " << GREEN << "Upload File" << RESET << std::endl;
     std::cout << "3. " << BLUE << "Download File" << RESET << std::endl;
-    std::cout << "4. " << RED << "Exit" << RESET << std::endl;
+    std::cout << "4. " << CYAN << "Copy Remote File" << RESET << std::endl;
+    std::cout << "5. " << CYAN << "Move Remote File" << RESET << std::endl;
+    std::cout << "6. " << GREEN << "Sync Directory" << RESET << std::endl;
+    std::cout << "7. " << RED << "Exit" << RESET << std::endl;
     std::cout << "===================================" << std::endl;
 }
 
@@ -131,56 +148,74 @@ void SFTPClient::uploadFile() {
         std::cout << RED << "File does not exist!" << RESET << std::endl;
         return;
     }
+    sendFile(filepath, true);
+}
 
+bool SFTPClient::sendFile(const std::string& filepath, bool showProgress) {
     std::string filename = fs::path(filepath).filename().string();
     uintmax_t filesize = fs::file_size(filepath);
+    uint64_t requestNs = Trace::enabled() ? Trace::nowNs() : 0;
 
     // 1. Send Upload Request (Filename)
-    std::cout << YELLOW << "[!] Requesting upload for: " << filename << "..." << RESET << std::endl;
+    if (showProgress) std::cout << YELLOW << "[!] Requesting upload for: " << filename << "..." << RESET << std::endl;
     Utils::sendPacket(ssl, PacketType::UPLOAD_REQ, filename);
 
     // 2. Wait for ACK
-    std::cout << YELLOW << "[!] Waiting for server approval..." << RESET << std::endl;
+    if (showProgress) std::cout << YELLOW << "[!] Waiting for server approval..." << RESET << std::endl;
     Utils::Packet ack = Utils::recvPacket(ssl);
     if (ack.type != PacketType::SUCCESS) {
         std::cout << RED << "[X] Server rejected upload: " << std::string(ack.payload.begin(), ack.payload.end()) << RESET << std::endl;
-        return;
+        return false;
     }
 
+    // Rejected requests are not transfers and leave no trace record
+    Trace::Transfer trace("upload", filename, requestNs);
+
     // 3. Send Chunks
     std::ifstream infile(filepath, std::ios::binary);
     std::vector<uint8_t> buffer(BUFFER_SIZE);
     uintmax_t totalSent = 0;
+    auto readChunk = [&]() {
+        Trace::Scope disk(Trace::Phase::Disk);
+        return static_cast<bool>(infile.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) || infile.gcount() > 0;
+    };
 
-    std::cout << GREEN << "[*] Starting transfer..." << RESET << std::endl;
-    
-    // Draw initial empty bar
-    drawProgressBar(0.0f);
+    if (showProgress) {
+        std::cout << GREEN << "[*] Starting transfer..." << RESET << std::endl;
+        // Draw initial empty bar
+        drawProgressBar(0.0f);
+    }
 
-    while (infile.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || infile.gcount() > 0) {
+    while (readChunk()) {
         std::vector<uint8_t> chunk(buffer.begin(), buffer.begin() + infile.gcount());
+        trace.firstByte();
         Utils::sendPacket(ssl, PacketType::FILE_CHUNK, chunk);
         
         totalSent += chunk.size();
-        drawProgressBar((float)totalSent / filesize);
+        trace.addBytes(chunk.size());
+        if (showProgress) drawProgressBar((float)totalSent / filesize);
+    }
+    if (showProgress) {
+        drawProgressBar(1.0f); // Ensure 100% at end
+        std::cout << std::endl;
+        std::cout << YELLOW << "[!] Finalizing transfer..." << RESET << std::endl;
     }
-    drawProgressBar(1.0f); // Ensure 100% at end
-    std::cout << std::endl;
-    
-    std::cout << YELLOW << "[!] Finalizing transfer..." << RESET << std::endl;
     Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{});
     
     // 4. Final confirmation
     Utils::Packet done = Utils::recvPacket(ssl);
     if (done.type == PacketType::SUCCESS) {
-        std::cout << GREEN << "[OK] Upload Successful!" << RESET << std::endl;
-    } else {
-        std::cout << RED << "[X] Upload failed server-side." << RESET << std::endl;
+        if (showProgress) std::cout << GREEN << "[OK] Upload Successful!" << RESET << std::endl;
+        trace.finish(true);
+        return true;
     }
+    std::cout << RED << "[X] Upload failed server-side: " << filename << RESET << std::endl;
+    return false;
 }
 
 void SFTPClient::downloadFile() {
     std::string filename = getLine("Enter filename to download");
+    uint64_t requestNs = Trace::enabled() ? Trace::nowNs() : 0;
     
     // 1. Send Download Request
     Utils::sendPacket(ssl, PacketType::DOWNLOAD_REQ, filename);
@@ -192,6 +227,8 @@ void SFTPClient::downloadFile() {
         return;
     }
 
+    // Rejected requests are not transfers and leave no trace record
+    Trace::Transfer trace("download", filename, requestNs);
     std::cout << "Downloading " << filename << "..." << std::endl;
     
     std::ofstream outfile(filename, std::ios::binary);
@@ -205,8 +242,13 @@ void SFTPClient::downloadFile() {
     while(transferring) {
         Utils::Packet chunk = Utils::recvPacket(ssl);
         if (chunk.type == PacketType::FILE_CHUNK) {
-            outfile.write(reinterpret_cast<const char*>(chunk.payload.data()), chunk.payload.size());
+            trace.firstByte();
+            {
+                Trace::Scope disk(Trace::Phase::Disk);
+                outfile.write(reinterpret_cast<const char*>(chunk.payload.data()), chunk.payload.size());
+            }
             totalBytes += chunk.payload.size();
+            trace.addBytes(chunk.payload.size());
             std::cout << "\rReceived: " << totalBytes << " bytes" << std::flush;
         } else if (chunk.type == PacketType::END_OF_TRANSFER) {
             transferring = false;
@@ -215,7 +257,149 @@ void SFTPClient::downloadFile() {
             return;
         }
     }
+    {
+        Trace::Scope disk(Trace::Phase::Disk);
+        outfile.close();
+    }
     std::cout << "\n" << GREEN << "Download Complete!" << RESET << std::endl;
+    trace.finish(true);
+}
+
+void SFTPClient::copyRemoteFile() {
+    sendFilePairRequest(PacketType::COPY_REQ, "copy");
+}
+
+void SFTPClient::moveRemoteFile() {
+    sendFilePairRequest(PacketType::MOVE_REQ, "move");
+}
+
+void SFTPClient::sendFilePairRequest(PacketType type, const std::string& verb) {
+    // The server performs the operation locally; no file data crosses the network.
+    std::string src = getLine("Enter remote filename to " + verb);
+    std::string dst = getLine("Enter new remote filename");
+
+    Utils::sendPacket(ssl, type, src + "\n" + dst);
+
+    Utils::Packet resp = Utils::recvPacket(ssl);
+    if (resp.type == PacketType::SUCCESS) {
+        std::cout << GREEN << "[OK] " << std::string(resp.payload.begin(), resp.payload.end()) << RESET << std::endl;
+    } else {
+        std::cout << RED << "[X] " << (resp.payload.empty() ? "Unknown Error" : std::string(resp.payload.begin(), resp.payload.end())) << RESET << std::endl;
+    }
+}
+
+void SFTPClient::syncDirectory() {
+    // Remote storage is a flat namespace, so only regular files directly inside dir are synced.
+    std::string dir = getLine("Enter local directory to sync");
+    if (!fs::is_directory(dir)) {
+        std::cout << RED << "Directory does not exist!" << RESET << std::endl;
+        return;
+    }
+    bool mirror = getLine("Delete remote files missing locally? (y/N)") == "y";
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Hashes are cached next to the tree so unchanged files are never re-read.
+    // Entries are keyed by name within dir, so "./tree" and "tree" share them.
+    const std::string cacheName = ".sftp_sync_cache";
+    std::string cacheFile = (fs::path(dir) / cacheName).string();
+    HashCache cache;
+    cache.load(cacheFile);
+
+    // 1. Build manifest
+    std::string manifest;
+    std::unordered_map<std::string, std::string> localPaths;
+    std::vector<std::string> skipped; // Subdirectories and unsupported names; the run is incomplete if any
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory()) {
+            skipped.push_back(name + "/");
+            continue;
+        }
+        if (!entry.is_regular_file()) continue;
+        if (name == cacheName) continue;
+        if (name.find_first_of("\t\n") != std::string::npos) {
+            skipped.push_back(name);
+            continue;
+        }
+        std::string path = entry.path().string();
+        manifest += name + "\t" + std::to_string(entry.file_size()) + "\t"
+                  + std::to_string(entry.last_write_time().time_since_epoch().count()) + "\t"
+                  + cache.getHash(name, path) + "\n";
+        localPaths[name] = path;
+    }
+
+    // Forget files that are gone so the cache tracks the current tree
+    std::unordered_set<std::string> present;
+    for (const auto& [name, path] : localPaths) present.insert(name);
+    cache.retainOnly(present);
+    cache.save(cacheFile);
+
+    // 2. Send manifest
+    Utils::sendPacket(ssl, PacketType::SYNC_REQ, std::string(mirror ? "mirror" : ""));
+    Utils::Packet ack = Utils::recvPacket(ssl);
+    if (ack.type != PacketType::SUCCESS) {
+        std::cout << RED << "[X] Server rejected sync: " << std::string(ack.payload.begin(), ack.payload.end()) << RESET << std::endl;
+        return;
+    }
+
+    // 3. Send the manifest in chunks; the server answers each with the entries that differ
+    std::vector<std::string> toUpload, toDelete;
+    auto readResponse = [&](const std::function<void(char, const std::string&)>& onLine) {
+        Utils::Packet resp = Utils::recvPacket(ssl);
+        if (resp.type == PacketType::END_OF_TRANSFER) return false;
+        if (resp.type != PacketType::SYNC_RESP) throw std::runtime_error("Unexpected packet during sync");
+
+        std::istringstream lines(std::string(resp.payload.begin(), resp.payload.end()));
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.size() >= 3 && line[1] == '\t') onLine(line[0], line.substr(2));
+        }
+        return true;
+    };
+
+    const size_t chunkSize = BUFFER_SIZE * 16;
+    for (size_t offset = 0; offset < manifest.size(); offset += chunkSize) {
+        Utils::sendPacket(ssl, PacketType::FILE_CHUNK, manifest.substr(offset, chunkSize));
+        readResponse([&](char kind, const std::string& name) {
+            if (kind == 'U' && localPaths.count(name)) toUpload.push_back(localPaths[name]);
+        });
+    }
+    Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{});
+
+    // 4. In mirror mode the server lists its files; anything not present locally is deleted
+    while (readResponse([&](char kind, const std::string& name) {
+        if (kind == 'R' && !localPaths.count(name)) toDelete.push_back(name);
+    })) {}
+
+    std::cout << CYAN << "[*] " << localPaths.size() << " local files, " << toUpload.size() << " to upload, "
+              << toDelete.size() << " to delete" << RESET << std::endl;
+
+    // 5. Transfer only what differs
+    size_t failed = 0;
+    for (size_t i = 0; i < toUpload.size(); ++i) {
+        std::cout << "\rUploading " << (i + 1) << "/" << toUpload.size() << std::flush;
+        if (!sendFile(toUpload[i], false)) ++failed;
+    }
+    if (!toUpload.empty()) std::cout << std::endl;
+
+    for (const auto& name : toDelete) {
+        Utils::sendPacket(ssl, PacketType::DELETE_REQ, name);
+        if (Utils::recvPacket(ssl).type != PacketType::SUCCESS) ++failed;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (!skipped.empty()) {
+        std::cout << YELLOW << "[!] Not synced (only top-level files are supported):" << RESET << std::endl;
+        for (const auto& name : skipped) std::cout << "    " << name << std::endl;
+    }
+    if (failed > 0) {
+        std::cout << RED << "[X] Sync finished with " << failed << " failures" << RESET << std::endl;
+    } else if (!skipped.empty()) {
+        std::cout << YELLOW << "[!] Sync incomplete: " << skipped.size() << " entries skipped" << RESET << std::endl;
+    } else {
+        std::cout << GREEN << "[OK] Sync complete in " << std::fixed << std::setprecision(2) << seconds << "s" << RESET << std::endl;
+    }
 }
 
 void SFTPClient::drawProgressBar(float percentage) {
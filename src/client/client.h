@@ -4,6 +4,7 @@
 #include <string>
 #include <openssl/ssl.h>
 #include <vector>
+#include "common.h"
 
 class SFTPClient {
 public:
@@ -22,7 +23,12 @@ private:
     void authenticate();
     void listFiles();
     void uploadFile();
+    bool sendFile(const std::string& filepath, bool showProgress);
     void downloadFile();
+    void copyRemoteFile();
+    void moveRemoteFile();
+    void sendFilePairRequest(PacketType type, const std::string& verb);
+    void syncDirectory();
     
     // UI Helpers
     void printMenu();
@@ -1,8 +1,10 @@
 #include "client.h"
 #include "platform.h"
+#include "trace.h"
 #include <iostream>
 
 int main(int argc, char* argv[]) {
+    Trace::initFromEnv();
     initSockets();
     try {
         std::string host = "127.0.0.1";
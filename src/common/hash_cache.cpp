@@ -0,0 +1,83 @@
+#include "hash_cache.h"
+#include "utils.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+std::string HashCache::getHash(const std::string& key, const std::string& path) {
+    uintmax_t size = fs::file_size(path);
+    int64_t mtime = fs::last_write_time(path).time_since_epoch().count();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.size == size && it->second.mtime == mtime) {
+            return it->second.hash;
+        }
+    }
+
+    // Hash outside the lock so other connections aren't stalled on disk reads
+    std::string hash = Utils::getFileChecksum(path);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = Entry{size, mtime, hash};
+    dirty = true;
+    return hash;
+}
+
+void HashCache::invalidate(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.erase(key)) dirty = true;
+}
+
+void HashCache::retainOnly(const std::unordered_set<std::string>& keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (keys.count(it->first)) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+            dirty = true;
+        }
+    }
+}
+
+bool HashCache::load(const std::string& cacheFile) {
+    // Format: one "size\tmtime\thash\tkey" line per entry
+    std::ifstream in(cacheFile);
+    if (!in.is_open()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        Entry entry;
+        std::string key;
+        if (fields >> entry.size >> entry.mtime >> entry.hash && fields.get() == '\t' && std::getline(fields, key)) {
+            entries[key] = entry;
+        }
+    }
+    return true;
+}
+
+bool HashCache::save(const std::string& cacheFile) const {
+    // Write then rename so an interrupted save never leaves a truncated cache
+    std::string tmp = cacheFile + ".tmp";
+    std::lock_guard<std::mutex> lock(mutex);
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open()) return false;
+        for (const auto& [key, entry] : entries) {
+            out << entry.size << '\t' << entry.mtime << '\t' << entry.hash << '\t' << key << '\n';
+        }
+        if (!out.good()) return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, cacheFile, ec);
+    if (ec) return false;
+    dirty = false;
+    return true;
+}
@@ -0,0 +1,48 @@
+#include "memory_budget.h"
+
+MemoryBudget::MemoryBudget(size_t limit, MemoryBudget* parent) : limitBytes(limit), parent(parent) {}
+
+bool MemoryBudget::tryReserve(size_t bytes) {
+    size_t current = usedBytes.load();
+    do {
+        if (bytes > limitBytes || current > limitBytes - bytes) return false;
+    } while (!usedBytes.compare_exchange_weak(current, current + bytes));
+
+    if (parent && !parent->tryReserve(bytes)) {
+        usedBytes -= bytes;
+        return false;
+    }
+
+    size_t newUsed = current + bytes;
+    size_t prevPeak = peakBytes.load();
+    while (newUsed > prevPeak && !peakBytes.compare_exchange_weak(prevPeak, newUsed)) {}
+    return true;
+}
+
+void MemoryBudget::release(size_t bytes) {
+    usedBytes -= bytes;
+    if (parent) parent->release(bytes);
+}
+
+MemoryReservation::MemoryReservation(MemoryReservation&& other) noexcept
+    : budget(other.budget), bytes(other.bytes) {
+    other.budget = nullptr;
+    other.bytes = 0;
+}
+
+MemoryReservation& MemoryReservation::operator=(MemoryReservation&& other) noexcept {
+    if (this != &other) {
+        reset();
+        budget = other.budget;
+        bytes = other.bytes;
+        other.budget = nullptr;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+void MemoryReservation::reset() {
+    if (budget && bytes > 0) budget->release(bytes);
+    budget = nullptr;
+    bytes = 0;
+}
@@ -0,0 +1,147 @@
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace Trace {
+    static std::atomic<bool> traceEnabled{false};
+    static std::mutex outputMutex;
+    static std::ofstream output;
+
+    static thread_local Transfer* currentTransfer = nullptr;
+    static thread_local std::string connPeer;
+    static thread_local uint64_t connHandshakeStartNs = 0;
+    static thread_local uint64_t connHandshakeEndNs = 0;
+    static thread_local uint64_t bioStartNs = 0;
+
+    void initFromEnv() {
+        const char* path = std::getenv("SFTP_TRACE");
+        if (!path || !*path) return;
+
+        output.open(path, std::ios::app);
+        if (!output.is_open()) {
+            fprintf(stderr, "Warning: cannot open trace file %s\n", path);
+            return;
+        }
+        traceEnabled = true;
+    }
+
+    bool enabled() {
+        return traceEnabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static long bioCallback(BIO*, int oper, const char*, size_t, int, long, int ret, size_t*) {
+        int base = oper & ~BIO_CB_RETURN;
+        if (base != BIO_CB_READ && base != BIO_CB_WRITE) return ret;
+
+        if (!(oper & BIO_CB_RETURN)) {
+            bioStartNs = nowNs();
+        } else if (currentTransfer) {
+            currentTransfer->add(Phase::Socket, nowNs() - bioStartNs);
+        }
+        return ret;
+    }
+
+    void instrument(SSL* ssl) {
+        if (!enabled()) return;
+        BIO* rbio = SSL_get_rbio(ssl);
+        BIO* wbio = SSL_get_wbio(ssl);
+        if (rbio) BIO_set_callback_ex(rbio, bioCallback);
+        if (wbio && wbio != rbio) BIO_set_callback_ex(wbio, bioCallback);
+    }
+
+    void setConnection(const std::string& peer, uint64_t handshakeStartNs, uint64_t handshakeEndNs) {
+        if (!enabled()) return;
+        connPeer = peer;
+        connHandshakeStartNs = handshakeStartNs;
+        connHandshakeEndNs = handshakeEndNs;
+    }
+
+    static std::string jsonEscape(const std::string& s) {
+        std::string out;
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    Transfer::Transfer(const char* op, const std::string& file, uint64_t requestNs) : op(op) {
+        if (!enabled()) return;
+        active = true;
+        this->file = file;
+        startNs = requestNs ? requestNs : nowNs();
+        previous = currentTransfer;
+        currentTransfer = this;
+    }
+
+    Transfer::~Transfer() {
+        if (!active) return;
+        finish(false); // Unwound by an exception before completing
+        currentTransfer = previous;
+    }
+
+    void Transfer::firstByte() {
+        if (active && firstByteNs == 0) firstByteNs = nowNs();
+    }
+
+    void Transfer::add(Phase phase, uint64_t ns) {
+        switch (phase) {
+        case Phase::Disk: diskNs += ns; break;
+        case Phase::Tls: tlsNs += ns; break;
+        case Phase::Socket: socketNs += ns; break;
+        }
+    }
+
+    Transfer* Transfer::current() {
+        return currentTransfer;
+    }
+
+    void Transfer::finish(bool ok) {
+        if (!active || startNs == 0) return;
+        uint64_t endNs = nowNs();
+
+        // Socket time is measured inside SSL_read/SSL_write; the remainder is crypto
+        uint64_t cryptoNs = tlsNs > socketNs ? tlsNs - socketNs : 0;
+
+        std::ostringstream line;
+        line << "{\"op\":\"" << op << "\""
+             << ",\"file\":\"" << jsonEscape(file) << "\""
+             << ",\"peer\":\"" << jsonEscape(connPeer) << "\""
+             << ",\"ok\":" << (ok ? "true" : "false")
+             << ",\"bytes\":" << bytes
+             << ",\"handshake_start_us\":" << connHandshakeStartNs / 1000
+             << ",\"handshake_us\":" << (connHandshakeEndNs - connHandshakeStartNs) / 1000
+             << ",\"request_us\":" << startNs / 1000
+             << ",\"first_byte_us\":";
+        if (firstByteNs) line << firstByteNs / 1000;
+        else line << "null";
+        line << ",\"end_us\":" << endNs / 1000
+             << ",\"total_us\":" << (endNs - startNs) / 1000
+             << ",\"disk_us\":" << diskNs / 1000
+             << ",\"crypto_us\":" << cryptoNs / 1000
+             << ",\"socket_us\":" << socketNs / 1000
+             << "}\n";
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output << line.str() << std::flush;
+        startNs = 0;
+    }
+}
@@ -1,10 +1,15 @@
 #include "utils.h"
 #include "utils.h"
 #include "platform.h"
+#include "trace.h"
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <iomanip> // For hex output if needed
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <openssl/evp.h>
 
 namespace Utils {
     
@@ -13,6 +18,8 @@ namespace Utils {
         header.type = type;
         header.length = htonl(payload.size()); // Network byte order
 
+        Trace::Scope tls(Trace::Phase::Tls);
+
         // Send Header
         int bytes = SSL_write(ssl, &header, sizeof(header));
         if (bytes <= 0) {
@@ -33,29 +40,91 @@ namespace Utils {
         sendPacket(ssl, type, data);
     }
 
-    Packet recvPacket(SSL* ssl) {
+    static void readExact(SSL* ssl, uint8_t* dst, size_t length, const char* what) {
+        Trace::Scope tls(Trace::Phase::Tls);
+        size_t totalRead = 0;
+        while (totalRead < length) {
+            int bytes = SSL_read(ssl, dst + totalRead, (int)(length - totalRead));
+            if (bytes <= 0) {
+                throw std::runtime_error(std::string("Error reading ") + what);
+            }
+            totalRead += bytes;
+        }
+    }
+
+    PacketHeader recvHeader(SSL* ssl) {
         PacketHeader header;
-        int bytes = SSL_read(ssl, &header, sizeof(header));
-        if (bytes <= 0) {
-             throw std::runtime_error("Connection closed or error reading header");
+        readExact(ssl, reinterpret_cast<uint8_t*>(&header), sizeof(header), "header");
+
+        header.length = ntohl(header.length);
+        if (header.length > MAX_FRAME_SIZE) {
+            throw std::runtime_error("Frame of " + std::to_string(header.length) + " bytes exceeds maximum frame size");
         }
+        return header;
+    }
 
-        header.length = ntohl(header.length); 
-        
+    Packet recvPayload(SSL* ssl, const PacketHeader& header, MemoryBudget* budget) {
         Packet packet;
         packet.type = header.type;
 
         if (header.length > 0) {
-            packet.payload.resize(header.length);
-            int totalRead = 0;
-            while (totalRead < header.length) {
-                bytes = SSL_read(ssl, packet.payload.data() + totalRead, header.length - totalRead);
-                if (bytes <= 0) {
-                    throw std::runtime_error("Error reading payload");
+            // Reserve before allocating so an oversized frame never reaches resize()
+            if (budget) {
+                if (!budget->tryReserve(header.length)) {
+                    throw std::runtime_error("Frame of " + std::to_string(header.length) + " bytes exceeds memory budget");
                 }
-                totalRead += bytes;
+                packet.reservation = MemoryReservation(budget, header.length);
             }
+            packet.payload.resize(header.length);
+            readExact(ssl, packet.payload.data(), header.length, "payload");
         }
         return packet;
     }
-}
+
+    void streamPayload(SSL* ssl, uint32_t length, const std::function<void(const uint8_t*, size_t)>& sink) {
+        uint8_t buffer[BUFFER_SIZE];
+        uint32_t remaining = length;
+        while (remaining > 0) {
+            int bytes;
+            {
+                Trace::Scope tls(Trace::Phase::Tls);
+                bytes = SSL_read(ssl, buffer, (int)std::min<uint32_t>(remaining, sizeof(buffer)));
+            }
+            if (bytes <= 0) {
+                throw std::runtime_error("Error reading payload");
+            }
+            sink(buffer, bytes);
+            remaining -= bytes;
+        }
+    }
+
+    Packet recvPacket(SSL* ssl, MemoryBudget* budget) {
+        return recvPayload(ssl, recvHeader(ssl), budget);
+    }
+
+    std::string getFileChecksum(const std::string& filepath) {
+        std::ifstream infile(filepath, std::ios::binary);
+        if (!infile.is_open()) {
+            throw std::runtime_error("Cannot open file for checksum: " + filepath);
+        }
+
+        EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
+
+        std::vector<char> buffer(BUFFER_SIZE * 16);
+        while (infile.read(buffer.data(), buffer.size()) || infile.gcount() > 0) {
+            EVP_DigestUpdate(mdctx, buffer.data(), infile.gcount());
+        }
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestLen = 0;
+        EVP_DigestFinal_ex(mdctx, digest, &digestLen);
+        EVP_MD_CTX_free(mdctx);
+
+        std::ostringstream hex;
+        for (unsigned int i = 0; i < digestLen; ++i) {
+            hex << std::hex << std::setw(2) << std::setfill('0') << (int)digest[i];
+        }
+        return hex.str();
+    }
+}
\ No newline at end of file
@@ -1,12 +1,37 @@
 #include "server.h"
 #include "common.h"
 #include "platform.h"
+#include "storage.h"
+#include "trace.h"
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool sharded = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sharded") {
+            sharded = true;
+        } else if (arg == "--migrate-to-sharded") {
+            // One-shot migration of an existing flat store; run with the server stopped
+            try {
+                size_t moved = Storage("server_storage", true).migrateToSharded();
+                std::cout << "Migrated " << moved << " files. Start the server with --sharded." << std::endl;
+                return 0;
+            } catch (const std::exception& e) {
+                std::cerr << "Migration Failed: " << e.what() << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--sharded | --migrate-to-sharded]" << std::endl;
+            return 1;
+        }
+    }
+
+    Trace::initFromEnv();
     initSockets();
     try {
-        SFTPServer server(SERVER_PORT);
+        SFTPServer server(SERVER_PORT, sharded);
         server.start();
     } catch (const std::exception& e) {
         std::cerr << "Server Crashed: " << e.what() << std::endl;
@@ -3,19 +3,109 @@
 #include "utils.h"
 #include "common.h"
 #include "platform.h"
+#include "trace.h"
 #include <iostream>
 #include <thread>
 #include <filesystem>
 #include <fstream>
 #include <cstring>
+#include <sstream>
+#include <unordered_set>
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <sys/ioctl.h>
+    #include <sys/stat.h>
+    #include <linux/fs.h>
+#endif
 
 namespace fs = std::filesystem;
 
-SFTPServer::SFTPServer(int port) : port(port) {
+// Splits a "source\ndestination" payload into two sanitized filenames
+static bool parseFilePair(const std::vector<uint8_t>& payload, std::string& src, std::string& dst) {
+    std::string request(payload.begin(), payload.end());
+    size_t sep = request.find('\n');
+    if (sep == std::string::npos) return false;
+    src = fs::path(request.substr(0, sep)).filename().string();
+    dst = fs::path(request.substr(sep + 1)).filename().string();
+    return !src.empty() && !dst.empty();
+}
+
+// Copies a file without sending data through userspace where possible:
+// reflink (FICLONE) first, then copy_file_range, then a plain chunked copy.
+static void copyFileLocal(const std::string& src, const std::string& dst) {
+#ifdef __linux__
+    int in = open(src.c_str(), O_RDONLY);
+    if (in < 0) throw std::runtime_error("Cannot open source file");
+
+    struct stat st;
+    if (fstat(in, &st) < 0) {
+        close(in);
+        throw std::runtime_error("Cannot stat source file");
+    }
+
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+    if (out < 0) {
+        close(in);
+        throw std::runtime_error("Cannot create destination file");
+    }
+
+    bool ok = ioctl(out, FICLONE, in) == 0;
+
+    if (!ok) {
+        off_t remaining = st.st_size;
+        bool rangeSupported = true;
+        while (remaining > 0) {
+            ssize_t n = copy_file_range(in, nullptr, out, nullptr, remaining, 0);
+            if (n <= 0) {
+                rangeSupported = (n == 0);
+                break;
+            }
+            remaining -= n;
+        }
+        ok = rangeSupported && remaining == 0;
+
+        if (!ok) {
+            // Fallback (e.g. EXDEV/ENOSYS): restart with a chunked copy
+            std::vector<char> buffer(BUFFER_SIZE * 16);
+            ok = lseek(in, 0, SEEK_SET) == 0 && ftruncate(out, 0) == 0 && lseek(out, 0, SEEK_SET) == 0;
+            ssize_t n = 0;
+            while (ok && (n = read(in, buffer.data(), buffer.size())) > 0) {
+                ssize_t written = 0;
+                while (written < n) {
+                    ssize_t w = write(out, buffer.data() + written, n - written);
+                    if (w <= 0) { ok = false; break; }
+                    written += w;
+                }
+            }
+            if (n < 0) ok = false;
+        }
+    }
+
+    close(in);
+    if (close(out) < 0) ok = false;
+    if (!ok) {
+        fs::remove(dst);
+        throw std::runtime_error("Copy failed");
+    }
+#else
+    fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+#endif
+}
+
+SFTPServer::SFTPServer(int port, bool sharded, const std::string& storageRoot) : port(port), storage(storageRoot, sharded) {
     SSLWrapper::initOpenSSL();
     ctx = SSLWrapper::createServerContext();
     SSLWrapper::configureContext(ctx, "certs/keys/server.crt", "certs/keys/server.key");
-    initStorage();
+    storage.init();
+
+    // Checksums survive restarts so the first sync after one does not re-hash the store
+    hashCacheFile = storage.root() + ".hashes";
+    hashCache.load(hashCacheFile);
+
+    // Drop entries for files removed while the server was down; the next sync persists the pruned cache
+    std::unordered_set<std::string> present;
+    for (const auto& name : storage.list()) present.insert(storage.pathFor(name));
+    hashCache.retainOnly(present);
 }
 
 SFTPServer::~SFTPServer() {
@@ -24,12 +114,6 @@ SFTPServer::~SFTPServer() {
     SSLWrapper::cleanupOpenSSL();
 }
 
-void SFTPServer::initStorage() {
-    if (!fs::exists(storage_dir)) {
-        fs::create_directory(storage_dir);
-    }
-}
-
 void SFTPServer::start() {
     serverSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (!IS_VALID_SOCKET(serverSocket)) {
@@ -50,7 +134,7 @@ void SFTPServer::start() {
         exit(EXIT_FAILURE);
     }
 
-    if (listen(serverSocket, 1) < 0) {
+    if (listen(serverSocket, SOMAXCONN) < 0) {
         perror("Unable to listen");
         exit(EXIT_FAILURE);
     }
@@ -66,6 +150,7 @@ void SFTPServer::start() {
             perror("Accept failed");
             continue;
         }
+        setNoDelay(clientSocket);
 
         std::thread clientThread(&SFTPServer::handleClient, this, clientSocket, clientAddr);
         clientThread.detach();
@@ -75,16 +160,23 @@ void SFTPServer::start() {
 void SFTPServer::handleClient(SocketType clientSocket, struct sockaddr_in addr) {
     SSL* ssl = SSL_new(ctx);
     SSL_set_fd(ssl, (int)clientSocket); // Cast strictly for OpenSSL on Linux/Win
+    Trace::instrument(ssl);
 
+    uint64_t handshakeStart = Trace::enabled() ? Trace::nowNs() : 0;
     if (SSL_accept(ssl) <= 0) {
         ERR_print_errors_fp(stderr);
     } else {
+        if (Trace::enabled()) Trace::setConnection(inet_ntoa(addr.sin_addr), handshakeStart, Trace::nowNs());
         std::cout << "[" << inet_ntoa(addr.sin_addr) << "] Connected securely via " << SSL_get_cipher(ssl) << std::endl;
 
+        // Buffered payloads for this connection count against both its own and the global budget
+        MemoryBudget connBudget(MAX_CONNECTION_MEMORY, &globalBudget);
+
         try {
             bool running = true;
             while (running) {
-                Utils::Packet packet = Utils::recvPacket(ssl);
+                Utils::Packet packet = Utils::recvPacket(ssl, &connBudget);
+                uint64_t requestNs = Trace::enabled() ? Trace::nowNs() : 0;
 
                 switch (packet.type) {
                 case PacketType::AUTH:
@@ -95,10 +187,22 @@ void SFTPServer::handleClient(SocketType clientSocket, struct sockaddr_in addr)
                     handleList(ssl);
                     break;
                 case PacketType::UPLOAD_REQ:
-                    handleUpload(ssl, packet.payload);
+                    handleUpload(ssl, packet.payload, connBudget, requestNs);
                     break;
                 case PacketType::DOWNLOAD_REQ:
-                    handleDownload(ssl, packet.payload);
+                    handleDownload(ssl, packet.payload, requestNs);
+                    break;
+                case PacketType::COPY_REQ:
+                    handleCopy(ssl, packet.payload);
+                    break;
+                case PacketType::MOVE_REQ:
+                    handleMove(ssl, packet.payload);
+                    break;
+                case PacketType::SYNC_REQ:
+                    handleSync(ssl, packet.payload, connBudget);
+                    break;
+                case PacketType::DELETE_REQ:
+                    handleDelete(ssl, packet.payload);
                     break;
                 case PacketType::END_OF_TRANSFER: // Explicit disconnect
                      running = false;
@@ -112,6 +216,9 @@ void SFTPServer::handleClient(SocketType clientSocket, struct sockaddr_in addr)
         } catch (const std::exception& e) {
             std::cerr << "Client Disconnected: " << e.what() << std::endl;
         }
+
+        std::cout << "[" << inet_ntoa(addr.sin_addr) << "] Peak buffered memory: " << connBudget.peak()
+                  << " bytes (global in use: " << globalBudget.used() << " bytes)" << std::endl;
     }
 
     SSL_shutdown(ssl);
@@ -121,26 +228,27 @@ void SFTPServer::handleClient(SocketType clientSocket, struct sockaddr_in addr)
 
 void SFTPServer::handleList(SSL* ssl) {
     std::string fileList;
-    for (const auto& entry : fs::directory_iterator(storage_dir)) {
-        fileList += entry.path().filename().string() + "\n";
+    for (const auto& name : storage.list()) {
+        fileList += name + "\n";
     }
     Utils::sendPacket(ssl, PacketType::LIST_RESP, fileList);
 }
 
-void SFTPServer::handleUpload(SSL* ssl, const std::vector<uint8_t>& initialPayload) {
+void SFTPServer::handleUpload(SSL* ssl, const std::vector<uint8_t>& initialPayload, MemoryBudget& budget, uint64_t requestNs) {
     // Protocol:
     // 1. Receive Filename (Already in initialPayload)
     // 2. Send ready ACK
     // 3. Loop recv chunks until END_OF_TRANSFER
+    //    Chunk payloads are streamed straight to disk, so their size is bounded only by MAX_FRAME_SIZE.
 
+    bool streaming = false; // Set once "Ready" is sent and the client starts sending chunks
     try {
         std::string filename(initialPayload.begin(), initialPayload.end());
         // Basic Security: prevent directory traversal
         filename = fs::path(filename).filename().string();
-        std::string filepath = storage_dir + "/" + filename;
-
-        std::cout << "Receiving file: " << filename << std::endl;
-        Utils::sendPacket(ssl, PacketType::SUCCESS, "Ready");
+        Trace::Transfer trace("upload", filename, requestNs);
+        std::string filepath = storage.prepareWrite(filename);
+        hashCache.invalidate(filepath);
 
         std::ofstream outfile(filepath, std::ios::binary);
         if (!outfile.is_open()) {
@@ -148,28 +256,48 @@ void SFTPServer::handleUpload(SSL* ssl, const std::vector<uint8_t>& initialPaylo
              return;
         }
 
+        std::cout << "Receiving file: " << filename << std::endl;
+        Utils::sendPacket(ssl, PacketType::SUCCESS, "Ready");
+        streaming = true;
+
         bool transferring = true;
         while(transferring) {
-             Utils::Packet chunk = Utils::recvPacket(ssl);
-             if (chunk.type == PacketType::FILE_CHUNK) {
-                 outfile.write(reinterpret_cast<const char*>(chunk.payload.data()), chunk.payload.size());
-             } else if (chunk.type == PacketType::END_OF_TRANSFER) {
+             PacketHeader header = Utils::recvHeader(ssl);
+             if (header.type == PacketType::FILE_CHUNK) {
+                 trace.firstByte();
+                 trace.addBytes(header.length);
+                 Utils::streamPayload(ssl, header.length, [&](const uint8_t* data, size_t size) {
+                     Trace::Scope disk(Trace::Phase::Disk);
+                     outfile.write(reinterpret_cast<const char*>(data), size);
+                 });
+                 continue;
+             }
+
+             Utils::Packet chunk = Utils::recvPayload(ssl, header, &budget);
+             if (chunk.type == PacketType::END_OF_TRANSFER) {
                  transferring = false;
              } else {
                  throw std::runtime_error("Unexpected packet during upload");
              }
         }
-        outfile.close();
+        {
+            Trace::Scope disk(Trace::Phase::Disk);
+            outfile.close();
+        }
         std::cout << "File received: " << filename << std::endl;
         Utils::sendPacket(ssl, PacketType::SUCCESS, "Upload Complete");
+        trace.finish(true);
 
     } catch (const std::exception& e) {
         std::cerr << "Upload Error: " << e.what() << std::endl;
         Utils::sendPacket(ssl, PacketType::ERROR, std::string("Upload Failed: ") + e.what());
+        // Before "Ready" the client is still waiting for the ACK, so the connection stays usable.
+        // After it the stream may be mid-frame; drop the connection rather than resync.
+        if (streaming) throw;
     }
 }
 
-void SFTPServer::handleDownload(SSL* ssl, const std::vector<uint8_t>& initialPayload) {
+void SFTPServer::handleDownload(SSL* ssl, const std::vector<uint8_t>& initialPayload, uint64_t requestNs) {
     // Protocol:
     // 1. Receive Filename (Already in initialPayload)
     // 2. Check exist -> Send SUCCESS/ERROR
@@ -178,27 +306,237 @@ void SFTPServer::handleDownload(SSL* ssl, const std::vector<uint8_t>& initialPay
     try {
         std::string filename(initialPayload.begin(), initialPayload.end());
         filename = fs::path(filename).filename().string(); // Security sanitization
-        std::string filepath = storage_dir + "/" + filename;
+        std::string filepath = storage.pathFor(filename);
 
         if (!fs::exists(filepath)) {
             Utils::sendPacket(ssl, PacketType::ERROR, "File not found");
             return;
         }
 
+        // Rejected requests are not transfers and leave no trace record
+        Trace::Transfer trace("download", filename, requestNs);
         Utils::sendPacket(ssl, PacketType::SUCCESS, "Starting Download");
         
         std::ifstream infile(filepath, std::ios::binary);
         std::vector<uint8_t> buffer(BUFFER_SIZE);
+        auto readChunk = [&]() {
+            Trace::Scope disk(Trace::Phase::Disk);
+            return static_cast<bool>(infile.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) || infile.gcount() > 0;
+        };
 
-        while (infile.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || infile.gcount() > 0) {
+        while (readChunk()) {
             std::vector<uint8_t> chunk(buffer.begin(), buffer.begin() + infile.gcount());
+            trace.firstByte();
+            trace.addBytes(chunk.size());
             Utils::sendPacket(ssl, PacketType::FILE_CHUNK, chunk);
         }
         
         Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{});
         std::cout << "Sent file: " << filename << std::endl;
+        trace.finish(true);
 
     } catch (const std::exception& e) {
          std::cerr << "Download Error: " << e.what() << std::endl;
     }
 }
+
+
+void SFTPServer::handleCopy(SSL* ssl, const std::vector<uint8_t>& initialPayload) {
+    // Protocol:
+    // 1. Receive "source\ndestination" (Already in initialPayload)
+    // 2. Copy locally on the server -> Send SUCCESS/ERROR
+
+    std::string src, dst;
+    if (!parseFilePair(initialPayload, src, dst)) {
+        Utils::sendPacket(ssl, PacketType::ERROR, "Malformed copy request");
+        return;
+    }
+
+    std::string srcPath = storage.pathFor(src);
+
+    std::error_code ec;
+    if (!fs::is_regular_file(srcPath, ec)) {
+        Utils::sendPacket(ssl, PacketType::ERROR, ec ? "Copy Failed: " + ec.message() : "File not found");
+        return;
+    }
+    if (src == dst) {
+        Utils::sendPacket(ssl, PacketType::ERROR, "Source and destination are the same");
+        return;
+    }
+
+    try {
+        std::string dstPath = storage.prepareWrite(dst);
+        hashCache.invalidate(dstPath);
+        copyFileLocal(srcPath, dstPath);
+        std::cout << "Copied file: " << src << " -> " << dst << std::endl;
+        Utils::sendPacket(ssl, PacketType::SUCCESS, "Copy Complete");
+    } catch (const std::exception& e) {
+        std::cerr << "Copy Error: " << e.what() << std::endl;
+        Utils::sendPacket(ssl, PacketType::ERROR, std::string("Copy Failed: ") + e.what());
+    }
+}
+
+void SFTPServer::handleMove(SSL* ssl, const std::vector<uint8_t>& initialPayload) {
+    // Protocol:
+    // 1. Receive "source\ndestination" (Already in initialPayload)
+    // 2. Rename locally on the server -> Send SUCCESS/ERROR
+
+    std::string src, dst;
+    if (!parseFilePair(initialPayload, src, dst)) {
+        Utils::sendPacket(ssl, PacketType::ERROR, "Malformed move request");
+        return;
+    }
+
+    std::string srcPath = storage.pathFor(src);
+
+    std::error_code ec;
+    if (!fs::is_regular_file(srcPath, ec)) {
+        Utils::sendPacket(ssl, PacketType::ERROR, ec ? "Move Failed: " + ec.message() : "File not found");
+        return;
+    }
+
+    std::string dstPath;
+    try {
+        dstPath = storage.prepareWrite(dst);
+    } catch (const fs::filesystem_error& e) {
+        ec = e.code();
+    }
+    if (!ec) {
+        hashCache.invalidate(srcPath);
+        hashCache.invalidate(dstPath);
+        fs::rename(srcPath, dstPath, ec);
+    }
+    if (ec) {
+        std::cerr << "Move Error: " << ec.message() << std::endl;
+        Utils::sendPacket(ssl, PacketType::ERROR, "Move Failed: " + ec.message());
+        return;
+    }
+
+    std::cout << "Moved file: " << src << " -> " << dst << std::endl;
+    Utils::sendPacket(ssl, PacketType::SUCCESS, "Move Complete");
+}
+
+void SFTPServer::handleSync(SSL* ssl, const std::vector<uint8_t>& initialPayload, MemoryBudget& budget) {
+    // Protocol:
+    // 1. Receive mode (Already in initialPayload): "mirror" also lists the server's files
+    // 2. Send ready ACK
+    // 3. For each manifest FILE_CHUNK of "name\tsize\tmtime\tsha256\n" lines (at most MAX_MANIFEST_CHUNK),
+    //    reply with one SYNC_RESP of "U\tname\n" lines for entries that differ
+    // 4. On END_OF_TRANSFER: in mirror mode send SYNC_RESP packets of "R\tname\n" lines for every
+    //    stored file, so the client can work out deletes -> Send END_OF_TRANSFER
+    // Answering per chunk keeps server state bounded no matter how long the manifest is.
+
+    bool mirror = std::string(initialPayload.begin(), initialPayload.end()) == "mirror";
+    Utils::sendPacket(ssl, PacketType::SUCCESS, "Ready");
+
+    std::string pending;
+    std::string diffs;
+    size_t entries = 0;
+
+    auto compareEntry = [&](const std::string& line) {
+        std::istringstream fields(line);
+        std::string name, hash;
+        uintmax_t size = 0;
+        int64_t mtime = 0; // Client-side mtime; only meaningful to the client's own cache
+        if (!std::getline(fields, name, '\t') || !(fields >> size >> mtime >> hash)) {
+            throw std::runtime_error("Malformed manifest entry");
+        }
+        name = fs::path(name).filename().string();
+        if (name.empty()) return;
+        ++entries;
+
+        std::string path = storage.pathFor(name);
+        std::error_code ec;
+        bool same = false;
+        // Size is checked first so most changed files never need hashing
+        if (fs::is_regular_file(path, ec) && fs::file_size(path, ec) == size) {
+            try {
+                same = hashCache.getHash(path) == hash;
+            } catch (const std::exception& e) {
+                // Deleted or replaced since the size check; have the client resend it
+                std::cerr << "Sync: cannot hash " << name << ": " << e.what() << std::endl;
+            }
+        }
+        if (!same) diffs += "U\t" + name + "\n";
+    };
+
+    bool receiving = true;
+    while (receiving) {
+        PacketHeader header = Utils::recvHeader(ssl);
+        if (header.type == PacketType::FILE_CHUNK) {
+            if (header.length > MAX_MANIFEST_CHUNK) {
+                throw std::runtime_error("Manifest chunk exceeds " + std::to_string(MAX_MANIFEST_CHUNK) + " bytes");
+            }
+            // A reply line is never longer than its manifest line, so the chunk plus a
+            // carried-over partial line bounds this chunk's reply
+            size_t replyBound = header.length + BUFFER_SIZE;
+            if (!budget.tryReserve(replyBound)) {
+                throw std::runtime_error("Sync exceeds memory budget");
+            }
+            MemoryReservation reservation(&budget, replyBound);
+
+            Utils::streamPayload(ssl, header.length, [&](const uint8_t* data, size_t size) {
+                pending.append(reinterpret_cast<const char*>(data), size);
+                size_t start = 0, end;
+                while ((end = pending.find('\n', start)) != std::string::npos) {
+                    compareEntry(pending.substr(start, end - start));
+                    start = end + 1;
+                }
+                pending.erase(0, start);
+                if (pending.size() > BUFFER_SIZE) {
+                    throw std::runtime_error("Manifest entry too long");
+                }
+            });
+
+            Utils::sendPacket(ssl, PacketType::SYNC_RESP, diffs);
+            diffs.clear();
+            continue;
+        }
+
+        Utils::Packet packet = Utils::recvPayload(ssl, header, &budget);
+        if (packet.type == PacketType::END_OF_TRANSFER) {
+            receiving = false;
+        } else {
+            throw std::runtime_error("Unexpected packet during sync");
+        }
+    }
+
+    if (mirror) {
+        std::string names;
+        for (const auto& name : storage.list()) {
+            names += "R\t" + name + "\n";
+            if (names.size() >= BUFFER_SIZE * 16) {
+                Utils::sendPacket(ssl, PacketType::SYNC_RESP, names);
+                names.clear();
+            }
+        }
+        if (!names.empty()) Utils::sendPacket(ssl, PacketType::SYNC_RESP, names);
+    }
+    Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{});
+    std::cout << "Sync compared " << entries << " entries" << std::endl;
+
+    if (hashCache.isDirty() && !hashCache.save(hashCacheFile)) {
+        std::cerr << "Warning: cannot save hash cache to " << hashCacheFile << std::endl;
+    }
+}
+
+void SFTPServer::handleDelete(SSL* ssl, const std::vector<uint8_t>& initialPayload) {
+    std::string filename(initialPayload.begin(), initialPayload.end());
+    filename = fs::path(filename).filename().string(); // Security sanitization
+    std::string filepath = storage.pathFor(filename);
+
+    std::error_code ec;
+    if (filename.empty() || !fs::is_regular_file(filepath, ec)) {
+        Utils::sendPacket(ssl, PacketType::ERROR, "File not found");
+        return;
+    }
+
+    hashCache.invalidate(filepath);
+    if (!fs::remove(filepath, ec) || ec) {
+        Utils::sendPacket(ssl, PacketType::ERROR, "Delete Failed: " + ec.message());
+        return;
+    }
+
+    std::cout << "Deleted file: " << filename << std::endl;
+    Utils::sendPacket(ssl, PacketType::SUCCESS, "Delete Complete");
+}
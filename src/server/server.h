@@ -7,26 +7,38 @@
 #include <openssl/ssl.h>
 #include <vector>
 #include "platform.h"
+#include "memory_budget.h"
+#include "common.h"
+#include "storage.h"
+#include "hash_cache.h"
 
 class SFTPServer {
 public:
-    SFTPServer(int port);
+    SFTPServer(int port, bool sharded = false, const std::string& storageRoot = "server_storage");
     ~SFTPServer();
     void start();
 
+    const MemoryBudget& memoryBudget() const { return globalBudget; }
+
 private:
     int port;
     SocketType serverSocket;
     SSL_CTX* ctx;
-    std::string storage_dir = "server_storage";
+    Storage storage;
+    HashCache hashCache;
+    std::string hashCacheFile;
+    MemoryBudget globalBudget{MAX_GLOBAL_MEMORY};
 
-    void initStorage();
     void handleClient(SocketType clientSocket, struct sockaddr_in addr);
     
     // Command Handlers
     void handleList(SSL* ssl);
-    void handleUpload(SSL* ssl, const std::vector<uint8_t>& initialPayload);
-    void handleDownload(SSL* ssl, const std::vector<uint8_t>& initialPayload);
+    void handleUpload(SSL* ssl, const std::vector<uint8_t>& initialPayload, MemoryBudget& budget, uint64_t requestNs);
+    void handleDownload(SSL* ssl, const std::vector<uint8_t>& initialPayload, uint64_t requestNs);
+    void handleCopy(SSL* ssl, const std::vector<uint8_t>& initialPayload);
+    void handleMove(SSL* ssl, const std::vector<uint8_t>& initialPayload);
+    void handleSync(SSL* ssl, const std::vector<uint8_t>& initialPayload, MemoryBudget& budget);
+    void handleDelete(SSL* ssl, const std::vector<uint8_t>& initialPayload);
 };
 
 #endif // SERVER_H
@@ -0,0 +1,159 @@
+#include "storage.h"
+#include <filesystem>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// FNV-1a with a murmur3 finalizer so short, similar names still spread over all 65536 shards.
+// Changing this function invalidates existing sharded stores.
+static uint32_t hashName(const std::string& name) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+Storage::Storage(const std::string& root, bool sharded) : rootDir(root), sharded(sharded) {}
+
+void Storage::init() {
+    if (!fs::exists(rootDir)) {
+        fs::create_directory(rootDir);
+    }
+    if (fs::exists(stagingDir())) {
+        throw std::runtime_error("Found an interrupted migration in " + stagingDir() + "; re-run --migrate-to-sharded");
+    }
+
+    std::string wanted = sharded ? "sharded" : "flat";
+    std::string layout = readLayout();
+
+    if (layout.empty()) {
+        // Stores created before the marker existed: infer the layout from the
+        // top level (flat stores hold only files, sharded ones only directories)
+        for (const auto& entry : fs::directory_iterator(rootDir)) {
+            if (sharded && entry.is_regular_file()) {
+                layout = "flat";
+                break;
+            }
+            if (!sharded && entry.is_directory()) {
+                layout = "sharded";
+                break;
+            }
+        }
+        if (layout.empty()) {
+            writeLayout(wanted);
+            return;
+        }
+    }
+
+    if (layout != wanted) {
+        throw std::runtime_error("Storage " + rootDir + " uses the " + layout + " layout; " +
+                                 (layout == "sharded" ? "start the server with --sharded" : "run --migrate-to-sharded first"));
+    }
+}
+
+std::string Storage::readLayout() const {
+    std::ifstream in(layoutFile());
+    std::string layout;
+    in >> layout;
+    return layout;
+}
+
+void Storage::writeLayout(const std::string& layout) const {
+    // Write then rename so a crash never leaves a truncated marker
+    std::string tmp = layoutFile() + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << layout << "\n";
+        if (!out.good()) throw std::runtime_error("Cannot write " + tmp);
+    }
+    fs::rename(tmp, layoutFile());
+}
+
+std::string Storage::shardDir(const std::string& filename) const {
+    uint32_t hash = hashName(filename);
+    char prefix[8];
+    snprintf(prefix, sizeof(prefix), "%02x/%02x", (hash >> 24) & 0xff, (hash >> 16) & 0xff);
+    return rootDir + "/" + prefix;
+}
+
+std::string Storage::pathFor(const std::string& filename) const {
+    if (!sharded) return rootDir + "/" + filename;
+    return shardDir(filename) + "/" + filename;
+}
+
+std::string Storage::prepareWrite(const std::string& filename) const {
+    if (sharded) {
+        // Shards fill up quickly; one stat is much cheaper than create_directories' walk
+        std::string dir = shardDir(filename);
+        std::error_code ec;
+        if (!fs::is_directory(dir, ec)) fs::create_directories(dir);
+        return dir + "/" + filename;
+    }
+    return pathFor(filename);
+}
+
+std::vector<std::string> Storage::list() const {
+    std::vector<std::string> names;
+    if (!sharded) {
+        for (const auto& entry : fs::directory_iterator(rootDir)) {
+            if (entry.is_regular_file()) names.push_back(entry.path().filename().string());
+        }
+        return names;
+    }
+
+    for (const auto& level1 : fs::directory_iterator(rootDir)) {
+        if (!level1.is_directory()) continue;
+        for (const auto& level2 : fs::directory_iterator(level1.path())) {
+            if (!level2.is_directory()) continue;
+            for (const auto& entry : fs::directory_iterator(level2.path())) {
+                if (entry.is_regular_file()) names.push_back(entry.path().filename().string());
+            }
+        }
+    }
+    return names;
+}
+
+size_t Storage::migrateToSharded() const {
+    fs::create_directories(rootDir);
+
+    // 1. Stage every top-level file outside the root. Names such as "60" would
+    //    otherwise block creation of the shard directory of the same name.
+    fs::create_directories(stagingDir());
+    for (const auto& entry : fs::directory_iterator(rootDir)) {
+        if (entry.is_regular_file()) {
+            fs::rename(entry.path(), stagingDir() + "/" + entry.path().filename().string());
+        }
+    }
+
+    // 2. Drain the staging directory into the shards. An interrupted run
+    //    leaves the remaining files staged, so a re-run picks them up here.
+    std::vector<fs::path> staged;
+    for (const auto& entry : fs::directory_iterator(stagingDir())) {
+        staged.push_back(entry.path());
+    }
+
+    size_t moved = 0;
+    for (const auto& path : staged) {
+        std::string name = path.filename().string();
+        fs::create_directories(shardDir(name));
+        fs::rename(path, shardDir(name) + "/" + name);
+        if (++moved % 100000 == 0) {
+            std::cout << "Migrated " << moved << " / " << staged.size() << " files" << std::endl;
+        }
+    }
+
+    fs::remove(stagingDir());
+    writeLayout("sharded");
+    return moved;
+}
@@ -0,0 +1,43 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <string>
+#include <vector>
+
+// Maps client-visible filenames to paths under the storage root.
+// Flat layout:    root/<name>
+// Sharded layout: root/<h0h1>/<h2h3>/<name>, where h is a hash of the name.
+// Clients only ever see <name>; the shard prefix stays server-side.
+// The layout in use is recorded in <root>.layout so a store is never
+// opened with the wrong one.
+class Storage {
+public:
+    Storage(const std::string& root, bool sharded);
+
+    void init();
+    const std::string& root() const { return rootDir; }
+
+    // Path for an existing or to-be-read file
+    std::string pathFor(const std::string& filename) const;
+    // Path for a file about to be written; creates its shard directories
+    std::string prepareWrite(const std::string& filename) const;
+    std::vector<std::string> list() const;
+
+    // Moves every file in a flat root into its shard. Returns the number moved.
+    // Safe to re-run after an interruption; it resumes where it stopped.
+    size_t migrateToSharded() const;
+
+private:
+    std::string rootDir;
+    bool sharded;
+
+    std::string shardDir(const std::string& filename) const;
+    // Siblings of the root, so they can never collide with a stored filename
+    std::string stagingDir() const { return rootDir + ".migrating"; }
+    std::string layoutFile() const { return rootDir + ".layout"; }
+
+    std::string readLayout() const;
+    void writeLayout(const std::string& layout) const;
+};
+
+#endif // STORAGE_H
@@ -0,0 +1,153 @@
+// Memory soak driver: runs an in-process server and floods it with
+// oversized and max-size frames over many connections, reporting the
+// global receive budget and process RSS after every round.
+//
+// Usage: memory_soak [rounds] [connections-per-round] [port]
+// Run from the project root so certs/keys/ is found. Uploads go to a
+// temporary store that is removed on exit.
+
+#include "server.h"
+#include "ssl_wrapper.h"
+#include "utils.h"
+#include "common.h"
+#include "platform.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static SSL* connectTo(SSL_CTX* ctx, int port, SocketType& fd) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return nullptr;
+
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_connect(ssl) <= 0) {
+        SSL_free(ssl);
+        return nullptr;
+    }
+    return ssl;
+}
+
+static void sendHeader(SSL* ssl, PacketType type, uint32_t length) {
+    PacketHeader header;
+    header.type = type;
+    header.length = htonl(length);
+    SSL_write(ssl, &header, sizeof(header));
+}
+
+// Each connection exercises one attack pattern:
+//   0: header claiming a 4 GB payload (rejected by MAX_FRAME_SIZE)
+//   1: max-size control frame (rejected by the per-connection budget)
+//   2: upload with a max-size FILE_CHUNK (streamed to disk)
+static void floodOnce(SSL_CTX* ctx, int port, int mode) {
+    SocketType fd;
+    SSL* ssl = connectTo(ctx, port, fd);
+    if (!ssl) {
+        if (IS_VALID_SOCKET(fd)) CLOSE_SOCKET(fd);
+        return;
+    }
+
+    try {
+        if (mode == 0) {
+            sendHeader(ssl, PacketType::UPLOAD_REQ, 0xFFFFFFFFu);
+        } else if (mode == 1) {
+            sendHeader(ssl, PacketType::LIST_REQ, MAX_FRAME_SIZE);
+        } else {
+            Utils::sendPacket(ssl, PacketType::UPLOAD_REQ, std::string("soak.bin"));
+            Utils::recvPacket(ssl);
+
+            std::vector<uint8_t> block(BUFFER_SIZE * 16, 0x5a);
+            sendHeader(ssl, PacketType::FILE_CHUNK, MAX_FRAME_SIZE);
+            for (uint32_t sent = 0; sent < MAX_FRAME_SIZE; sent += block.size()) {
+                SSL_write(ssl, block.data(), (int)std::min<size_t>(block.size(), MAX_FRAME_SIZE - sent));
+            }
+            Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{});
+            Utils::recvPacket(ssl);
+            Utils::sendPacket(ssl, PacketType::END_OF_TRANSFER, std::vector<uint8_t>{}); // Bye
+        }
+        // Wait for the server to drop or finish with the connection
+        char byte;
+        SSL_read(ssl, &byte, 1);
+    } catch (const std::exception&) {
+        // Expected: the server closes connections it rejects
+    }
+
+    SSL_free(ssl);
+    CLOSE_SOCKET(fd);
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 10;
+    int connections = argc > 2 ? std::atoi(argv[2]) : 48;
+    int port = argc > 3 ? std::atoi(argv[3]) : SERVER_PORT + 1;
+
+    // SSLWrapper exits on a missing certificate, which would skip the cleanup below
+    if (!fs::exists("certs/keys/server.crt") || !fs::exists("certs/keys/server.key")) {
+        std::cerr << "Soak Setup Failed: run from the project root so certs/keys/ is found" << std::endl;
+        return 1;
+    }
+
+    // Keep soak uploads away from the real server_storage
+    fs::path soakDir = fs::temp_directory_path() / ("sftp_soak_" + std::to_string(getpid()));
+    std::unique_ptr<SFTPServer> serverPtr;
+    try {
+        fs::create_directories(soakDir);
+        serverPtr = std::make_unique<SFTPServer>(port, false, (soakDir / "server_storage").string());
+    } catch (const std::exception& e) {
+        std::cerr << "Soak Setup Failed: " << e.what() << std::endl;
+        fs::remove_all(soakDir);
+        return 1;
+    }
+    SFTPServer& server = *serverPtr;
+
+    initSockets();
+    std::thread([&server]() { server.start(); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    SSL_CTX* ctx = SSLWrapper::createClientContext();
+    size_t baseline = residentBytes();
+    std::cout << "[soak] baseline RSS " << baseline / 1024 << " KiB, frame limit " << MAX_FRAME_SIZE
+              << " bytes, connection budget " << MAX_CONNECTION_MEMORY << " bytes" << std::endl;
+
+    for (int round = 1; round <= rounds; ++round) {
+        auto started = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (int i = 0; i < connections; ++i) {
+            clients.emplace_back(floodOnce, ctx, port, i % 3);
+        }
+        for (auto& t : clients) t.join();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Let server threads unwind
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        const MemoryBudget& budget = server.memoryBudget();
+        std::cout << "[soak] round " << round << ": " << connections << " connections in " << seconds << "s"
+                  << ", budget in use " << budget.used() << " bytes"
+                  << ", budget peak " << budget.peak() << " bytes"
+                  << ", RSS " << residentBytes() / 1024 << " KiB" << std::endl;
+    }
+
+    SSL_CTX_free(ctx);
+    std::error_code ec;
+    fs::remove_all(soakDir, ec);
+    // The server thread never returns from accept(); exit without joining it
+    std::_Exit(server.memoryBudget().used() == 0 ? 0 : 1);
+}
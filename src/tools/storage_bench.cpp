@@ -0,0 +1,108 @@
+// Storage layout benchmark: creates N empty files through Storage in the
+// flat and sharded layouts, then measures create, lookup (hit and miss)
+// and list latency.
+//
+// Usage: storage_bench [files] [bench-dir]
+// Defaults to 1000000 files under ./storage_bench; the directory is removed afterwards.
+
+#include "storage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+static double elapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void report(const std::string& label, std::vector<double>& samples) {
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double s : samples) total += s;
+    auto pct = [&](double p) { return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))]; };
+
+    std::cout << "  " << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(2)
+              << " avg " << std::setw(8) << total / samples.size() << " us"
+              << "  p50 " << std::setw(8) << pct(0.50) << " us"
+              << "  p99 " << std::setw(8) << pct(0.99) << " us"
+              << "  max " << std::setw(9) << samples.back() << " us" << std::endl;
+}
+
+static std::string fileName(size_t i) {
+    char name[32];
+    snprintf(name, sizeof(name), "file_%09zu.dat", i);
+    return name;
+}
+
+static void bench(const std::string& root, bool sharded, size_t count) {
+    std::cout << (sharded ? "sharded" : "flat") << " layout, " << count << " files" << std::endl;
+    Storage storage(root, sharded);
+    storage.init();
+
+    // Create: sample the last 10% so the numbers reflect a full store
+    std::vector<double> createLate;
+    for (size_t i = 0; i < count; ++i) {
+        auto start = Clock::now();
+        std::string path = storage.prepareWrite(fileName(i));
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) {
+            std::cerr << "Cannot create " << path << std::endl;
+            std::exit(1);
+        }
+        fclose(f);
+        if (i >= count - count / 10) createLate.push_back(elapsedUs(start));
+    }
+    report("create (last 10%)", createLate);
+
+    // Lookup: the fs::exists(pathFor(name)) check handleDownload performs
+    std::mt19937_64 rng(42);
+    const size_t lookups = std::min<size_t>(count, 100000);
+    std::vector<double> hits, misses;
+    for (size_t i = 0; i < lookups; ++i) {
+        std::string name = fileName(rng() % count);
+        auto start = Clock::now();
+        bool found = fs::exists(storage.pathFor(name));
+        hits.push_back(elapsedUs(start));
+        if (!found) std::cerr << "Missing " << name << std::endl;
+
+        name = "absent_" + std::to_string(rng()) + ".dat";
+        start = Clock::now();
+        (void)fs::exists(storage.pathFor(name));
+        misses.push_back(elapsedUs(start));
+    }
+    report("lookup hit", hits);
+    report("lookup miss", misses);
+
+    auto start = Clock::now();
+    size_t listed = storage.list().size();
+    std::cout << "  list                 " << std::fixed << std::setprecision(1) << elapsedUs(start) / 1000
+              << " ms (" << listed << " names)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::string dir = argc > 2 ? argv[2] : "storage_bench";
+    if (count == 0) {
+        std::cerr << "Usage: " << argv[0] << " [files] [bench-dir]" << std::endl;
+        return 1;
+    }
+
+    if (fs::exists(dir)) {
+        std::cerr << dir << " already exists; choose an unused bench directory" << std::endl;
+        return 1;
+    }
+    fs::create_directories(dir);
+    bench(dir + "/flat", false, count);
+    bench(dir + "/sharded", true, count);
+    fs::remove_all(dir);
+    return 0;
+}